@@ -1,6 +1,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+
+// Poltica ante un nmero de factura que ya tiene ventas registradas. Se elige en
+// configuracion.txt con la lnea facturas_repetidas=rechazar, advertir o permitir
+#define FACTURA_RECHAZAR  0   // No se permite cargar la venta
+#define FACTURA_ADVERTIR  1   // Se avisa y se carga igual (factura con varias lneas)
+#define FACTURA_PERMITIR  2   // Se carga sin avisar
+#ifndef POLITICA_FACTURA_DUPLICADA   // Poltica si configuracion.txt no indica otra
+#define POLITICA_FACTURA_DUPLICADA FACTURA_ADVERTIR
+#endif
+
+#define BLOOM_BITS 65536      // Tamao del filtro de Bloom de facturas (en bits)
+#define LARGO_HUELLA 42       // "tamao modificacin" de ventas.txt, a ancho fijo (20 + 1 + 20 + '\0')
 
 // Estructuras de datos - Definen los "moldes" para nuestros datos
 
@@ -24,8 +37,20 @@ typedef struct {
     int idProducto;          // ID del producto vendido (referencia a Producto)
     int codigoCiudad;        // Cdigo de la ciudad donde se vendi (referencia a Ciudad)
     float cantidadVendida;   // Cantidad de unidades vendidas
+    float precioUnitario;    // Precio del producto al momento de la venta
 } Venta;
 
+// ndice de nmeros de factura ya usados. En facturas.idx la primera lnea es la huella
+// (tamao y fecha de modificacin) de ventas.txt cuando se escribi el ndice, y despus
+// va un nmero de factura por lnea
+typedef struct {
+    int *numeros;                           // Facturas ordenadas de menor a mayor
+    int cantidad;                           // Cantidad de facturas en el ndice
+    int capacidad;                          // Lugar reservado en numeros
+    int incompleto;                         // 1 si falt memoria y numeros no tiene todas las facturas
+    unsigned char bloom[BLOOM_BITS / 8];    // Filtro de Bloom: descarta rpido las facturas nuevas
+} IndiceFacturas;
+
 void mostrarMenu();                           // Muestra el men principal
 void borrarArchivos();                        // Borra/limpia los archivos de datos
 void cargarProductos();                       // Permite cargar nuevos productos
@@ -36,12 +61,32 @@ void listadoPorProductoYCiudad();            // Muestra ventas agrupadas por pro
 void mostrarEstadisticas();                  // Muestra estadsticas de ventas
 int buscarProducto(int idProducto, Producto *productoInfo);  // Busca un producto por ID
 int buscarCiudad(int codigoCiudad, Ciudad *ciudadInfo);      // Busca una ciudad por cdigo
+int parsearVenta(char *linea, Venta *ventaInfo);             // Convierte una linea de ventas.txt en una Venta
+void migrarVentas();                         // Agrega el precio unitario a las ventas antiguas
+int contarCampos(const char *linea);         // Cuenta los campos separados por | de una lnea
+void obtenerProducto(int idProducto, Producto vistos[], int *numVistos, Producto *productoInfo); // Busca con cach de productos ledos
+void obtenerCiudad(int codigoCiudad, Ciudad vistas[], int *numVistas, Ciudad *ciudadInfo);      // Busca con cach de ciudades ledas
+int cargarIndiceFacturas(IndiceFacturas *indice);               // Lee (o reconstruye) el ndice de facturas
+int existeFactura(IndiceFacturas *indice, int numeroFactura);   // Indica si la factura ya fue usada
+int agregarFactura(IndiceFacturas *indice, int numeroFactura);  // Registra una factura en el ndice
+void guardarIndiceFacturas(IndiceFacturas *indice);             // Escribe facturas.idx y libera el ndice
+int escribirIndiceFacturas(IndiceFacturas *indice);             // Reescribe facturas.idx ordenado
+int agregarNumero(IndiceFacturas *indice, int numeroFactura);   // Agrega un nmero al final del arreglo
+void ordenarSinRepetidos(IndiceFacturas *indice);               // Ordena el arreglo y quita repetidos
+void marcarBloom(IndiceFacturas *indice, int numeroFactura);    // Marca una factura en el filtro de Bloom
+unsigned int posicionBloom(int numeroFactura, int i);           // Bit i-simo del filtro para una factura
+int compararEnteros(const void *a, const void *b);              // Comparador para qsort y bsearch
+int leerNumero(const char *texto, int *numero);                 // Convierte texto a entero validando el formato
+void huellaVentas(char huella[LARGO_HUELLA]);                   // Tamao y fecha de modificacin de ventas.txt
+int leerPoliticaFacturas();                                     // Lee la poltica de facturas de configuracion.txt
 void pausar();                               // Pausa la ejecucin hasta que se presione ENTER
 
 // Funcin principal - Punto de entrada del programa
 int main() {
     int opcionUsuario;  // Variable para la opcin elegida por el usuario
 
+    migrarVentas();     // Completar el precio de las ventas cargadas con versiones anteriores
+
     // Bucle principal, se ejecuta hasta que el usuario elija salir
     do {
         mostrarMenu();                    // Mostrar las opciones disponibles
@@ -129,6 +174,12 @@ void borrarArchivos() {
         fclose(archivo);
     }
 
+    // Crear archivo facturas.idx vaco (el ndice acompaa a ventas.txt)
+    archivo = fopen("facturas.idx", "w");
+    if (archivo != NULL) {
+        fclose(archivo);
+    }
+
 
 }
 
@@ -219,10 +270,18 @@ void cargarVentas() {
     Venta ventaInfo;
     Producto productoInfo;
     Ciudad ciudadInfo;
+    IndiceFacturas indice;
+    int politica = leerPoliticaFacturas();
+
+    if (!cargarIndiceFacturas(&indice)) {
+        printf("Error al cargar el indice de facturas\n");
+        return;
+    }
 
     archivo = fopen("ventas.txt", "a");
     if (archivo == NULL) {
         printf("Error al abrir archivo ventas.txt\n"); //aca si el archivo esta "vacio" va tirar "error"
+        guardarIndiceFacturas(&indice);
         return;
     }
 
@@ -233,6 +292,16 @@ void cargarVentas() {
         scanf("%d", &ventaInfo.numeroFactura);
         if (ventaInfo.numeroFactura == 0) break;
 
+        // Controlar facturas repetidas segn la poltica configurada
+        if (politica != FACTURA_PERMITIR &&
+            existeFactura(&indice, ventaInfo.numeroFactura)) {
+            if (politica == FACTURA_RECHAZAR) {
+                printf("La factura %d ya existe.\n", ventaInfo.numeroFactura);
+                continue;
+            }
+            printf("Atencion: la factura %d ya tiene ventas registradas.\n", ventaInfo.numeroFactura);
+        }
+
         printf("Ingrese fecha (DDMMAAAA): ");
         scanf(" %8s", ventaInfo.fechaVenta);
 
@@ -243,6 +312,7 @@ void cargarVentas() {
 
             if (ventaInfo.idProducto == 0) {
                 fclose(archivo);
+                guardarIndiceFacturas(&indice);
                 return;
             }
 
@@ -261,6 +331,7 @@ void cargarVentas() {
 
             if (ventaInfo.codigoCiudad == 0) {
                 fclose(archivo);
+                guardarIndiceFacturas(&indice);
                 return;
             }
 
@@ -275,16 +346,318 @@ void cargarVentas() {
         printf("Ingrese cantidad: ");
         scanf("%f", &ventaInfo.cantidadVendida);
 
+        // Se guarda el precio vigente para que los reportes no dependan de cambios futuros
+        ventaInfo.precioUnitario = productoInfo.precioProducto;
+
         // muestra una especie de resumen
-        fprintf(archivo, "%d|%s|%d|%d|%.2f\n", ventaInfo.numeroFactura,
+        fprintf(archivo, "%d|%s|%d|%d|%.2f|%.2f\n", ventaInfo.numeroFactura,
                ventaInfo.fechaVenta, ventaInfo.idProducto,
-               ventaInfo.codigoCiudad, ventaInfo.cantidadVendida);
+               ventaInfo.codigoCiudad, ventaInfo.cantidadVendida,
+               ventaInfo.precioUnitario);
+        fflush(archivo);  // El ndice guarda la huella de ventas.txt: la venta tiene que estar en disco
+        if (!agregarFactura(&indice, ventaInfo.numeroFactura)) {
+            printf("Atencion: sin memoria para el indice, la factura %d no se controlara en esta carga.\n",
+                   ventaInfo.numeroFactura);
+        }
        printf("\n");  // Espacio entre ventas
         system("cls");  // Limpiar pantalla despus de cada venta
         printf("\n=== CARGA DE VENTAS ===\n");
     }
 
     fclose(archivo);
+    guardarIndiceFacturas(&indice);
+}
+
+// Lee la lnea facturas_repetidas=... de configuracion.txt. Si el archivo o la lnea faltan,
+// o el valor no es vlido, se usa POLITICA_FACTURA_DUPLICADA
+int leerPoliticaFacturas() {
+    FILE *archivo;
+    char linea[100];
+    int politica = POLITICA_FACTURA_DUPLICADA;
+
+    archivo = fopen("configuracion.txt", "r");
+    if (archivo == NULL) {
+        return politica;
+    }
+
+    while (fgets(linea, sizeof(linea), archivo)) {
+        char *clave = strtok(linea, "=");
+        char *valor = strtok(NULL, " \t\r\n");
+        if (clave == NULL || valor == NULL || strcmp(clave, "facturas_repetidas") != 0) continue;
+
+        if (strcmp(valor, "rechazar") == 0) {
+            politica = FACTURA_RECHAZAR;
+        } else if (strcmp(valor, "advertir") == 0) {
+            politica = FACTURA_ADVERTIR;
+        } else if (strcmp(valor, "permitir") == 0) {
+            politica = FACTURA_PERMITIR;
+        } else {
+            printf("Valor invalido en configuracion.txt: facturas_repetidas=%s\n", valor);
+        }
+    }
+
+    fclose(archivo);
+    return politica;
+}
+
+// Comparador de enteros para qsort y bsearch
+int compararEnteros(const void *a, const void *b) {
+    int x = *(const int *)a;
+    int y = *(const int *)b;
+    return (x > y) - (x < y);
+}
+
+// Calcula la posicin del bit i-simo del filtro de Bloom para una factura (doble hash)
+unsigned int posicionBloom(int numeroFactura, int i) {
+    // Hash multiplicativo: se usan los 16 bits altos, que dependen de todo el nmero
+    // (los bajos solo dependen de los 16 bits bajos de la factura)
+    unsigned int h1 = ((unsigned int)numeroFactura * 2654435761u) >> 16;
+    unsigned int h2 = (((unsigned int)numeroFactura ^ 0x5bd1e995u) * 0x9e3779b1u) >> 16;
+    return (h1 + i * (h2 | 1)) % BLOOM_BITS;
+}
+
+// Marca una factura en el filtro de Bloom (3 bits por factura)
+void marcarBloom(IndiceFacturas *indice, int numeroFactura) {
+    for (int i = 0; i < 3; i++) {
+        unsigned int bit = posicionBloom(numeroFactura, i);
+        indice->bloom[bit / 8] |= (unsigned char)(1 << (bit % 8));
+    }
+}
+
+// Agrega un nmero al final del arreglo, agrandandolo si hace falta
+int agregarNumero(IndiceFacturas *indice, int numeroFactura) {
+    if (indice->cantidad == indice->capacidad) {
+        int nuevaCapacidad = indice->capacidad == 0 ? 64 : indice->capacidad * 2;
+        int *nuevos = realloc(indice->numeros, nuevaCapacidad * sizeof(int));
+        if (nuevos == NULL) {
+            return 0;
+        }
+        indice->numeros = nuevos;
+        indice->capacidad = nuevaCapacidad;
+    }
+    indice->numeros[indice->cantidad++] = numeroFactura;
+    return 1;
+}
+
+// Ordena el arreglo y deja una sola vez cada factura (bsearch necesita el arreglo ordenado)
+void ordenarSinRepetidos(IndiceFacturas *indice) {
+    if (indice->cantidad == 0) {
+        return;
+    }
+
+    qsort(indice->numeros, indice->cantidad, sizeof(int), compararEnteros);
+    int unicos = 1;
+    for (int i = 1; i < indice->cantidad; i++) {
+        if (indice->numeros[i] != indice->numeros[unicos - 1]) {
+            indice->numeros[unicos++] = indice->numeros[i];
+        }
+    }
+    indice->cantidad = unicos;
+}
+
+// Convierte el texto a entero; devuelve 0 si est vaco o tiene caracteres que no son del nmero
+int leerNumero(const char *texto, int *numero) {
+    char *fin;
+    long valor = strtol(texto, &fin, 10);
+
+    if (fin == texto) {
+        return 0;
+    }
+    while (*fin == ' ' || *fin == '\t' || *fin == '\r' || *fin == '\n') {
+        fin++;
+    }
+    if (*fin != '\0') {
+        return 0;
+    }
+
+    *numero = (int)valor;
+    return 1;
+}
+
+// Arma la huella de ventas.txt: tamao y fecha de modificacin, a ancho fijo para poder
+// pisarla en el lugar. Si ventas.txt no existe la huella es todo ceros
+void huellaVentas(char huella[LARGO_HUELLA]) {
+    struct stat datos;
+    long tamano = 0;
+    long long modificado = 0;
+
+    if (stat("ventas.txt", &datos) == 0) {
+        tamano = (long)datos.st_size;
+        modificado = (long long)datos.st_mtime;
+    }
+
+    sprintf(huella, "%020ld %020lld", tamano, modificado);
+}
+
+// Lee facturas.idx. Si falta, o si la huella guardada no coincide con la de ventas.txt
+// (ventas editadas o agregadas por fuera del programa, o una carga cortada), lo arma de
+// nuevo desde ventas.txt
+int cargarIndiceFacturas(IndiceFacturas *indice) {
+    FILE *archivo;
+    char linea[200];
+    int numero;
+    int vigente = 0;    // 1 si facturas.idx corresponde al ventas.txt actual
+    int ordenado = 1;
+
+    indice->numeros = NULL;
+    indice->cantidad = 0;
+    indice->capacidad = 0;
+    indice->incompleto = 0;
+    memset(indice->bloom, 0, sizeof(indice->bloom));
+
+    archivo = fopen("facturas.idx", "r");
+    if (archivo != NULL) {
+        char huella[LARGO_HUELLA];
+        huellaVentas(huella);
+        if (fgets(linea, sizeof(linea), archivo)) {
+            linea[strcspn(linea, "\r\n")] = '\0';
+            vigente = strcmp(linea, huella) == 0;
+        }
+
+        while (vigente && fgets(linea, sizeof(linea), archivo)) {
+            if (!leerNumero(linea, &numero)) continue;  // Lneas vacas o daadas se ignoran
+            if (!agregarNumero(indice, numero)) {
+                fclose(archivo);
+                free(indice->numeros);
+                return 0;
+            }
+        }
+        fclose(archivo);
+    }
+
+    if (!vigente) {
+        // Tomar el nmero de factura de cada venta
+        archivo = fopen("ventas.txt", "r");
+        if (archivo != NULL) {
+            while (fgets(linea, sizeof(linea), archivo)) {
+                char *token = strtok(linea, "|");
+                if (token == NULL || !leerNumero(token, &numero)) continue;
+                if (!agregarNumero(indice, numero)) {
+                    fclose(archivo);
+                    free(indice->numeros);
+                    return 0;
+                }
+            }
+            fclose(archivo);
+        }
+    }
+
+    // Las facturas agregadas durante una carga quedan al final del archivo, fuera de orden
+    for (int i = 1; i < indice->cantidad; i++) {
+        if (indice->numeros[i] <= indice->numeros[i - 1]) {
+            ordenado = 0;
+            break;
+        }
+    }
+
+    if (!vigente || !ordenado) {
+        ordenarSinRepetidos(indice);
+        escribirIndiceFacturas(indice);
+    }
+
+    for (int i = 0; i < indice->cantidad; i++) {
+        marcarBloom(indice, indice->numeros[i]);
+    }
+
+    return 1;
+}
+
+// El filtro de Bloom responde "seguro que no existe" sin buscar; si duda, se busca en el arreglo ordenado
+int existeFactura(IndiceFacturas *indice, int numeroFactura) {
+    for (int i = 0; i < 3; i++) {
+        unsigned int bit = posicionBloom(numeroFactura, i);
+        if (!(indice->bloom[bit / 8] & (1 << (bit % 8)))) {
+            return 0;
+        }
+    }
+
+    if (indice->cantidad == 0) {
+        return 0;
+    }
+
+    return bsearch(&numeroFactura, indice->numeros, indice->cantidad,
+                   sizeof(int), compararEnteros) != NULL;
+}
+
+// Registra la venta recin escrita en ventas.txt (ya volcada a disco con fflush).
+// Primero se agrega la factura al final de facturas.idx y despus se actualiza la huella del
+// encabezado: si el programa se corta en el medio, la huella no coincide y el ndice se reconstruye.
+// Devuelve 0 si no hubo memoria para agregarla al arreglo (en disco s queda registrada)
+int agregarFactura(IndiceFacturas *indice, int numeroFactura) {
+    FILE *archivo;
+    int posicion;
+    int nueva = !existeFactura(indice, numeroFactura);
+    char huella[LARGO_HUELLA];
+
+    archivo = fopen("facturas.idx", "r+");
+    if (archivo != NULL) {
+        if (nueva) {
+            fseek(archivo, 0, SEEK_END);
+            fprintf(archivo, "%d\n", numeroFactura);
+        }
+        huellaVentas(huella);
+        fseek(archivo, 0, SEEK_SET);
+        fprintf(archivo, "%s\n", huella);  // Ancho fijo: se pisa en el lugar
+        fclose(archivo);
+    }
+
+    if (!nueva) {
+        return 1;
+    }
+
+    if (!agregarNumero(indice, numeroFactura)) {
+        indice->incompleto = 1;  // Evita que guardarIndiceFacturas pise facturas.idx con el arreglo incompleto
+        return 0;
+    }
+
+    // Insertar la factura en su posicin para mantener el arreglo ordenado
+    posicion = indice->cantidad - 1;
+    while (posicion > 0 && indice->numeros[posicion - 1] > numeroFactura) {
+        indice->numeros[posicion] = indice->numeros[posicion - 1];
+        posicion--;
+    }
+    indice->numeros[posicion] = numeroFactura;
+
+    marcarBloom(indice, numeroFactura);
+    return 1;
+}
+
+// Escribe facturas.idx completo: la huella actual de ventas.txt y las facturas ordenadas
+int escribirIndiceFacturas(IndiceFacturas *indice) {
+    FILE *archivo;
+    int error;
+    char huella[LARGO_HUELLA];
+
+    archivo = fopen("facturas.idx", "w");
+    if (archivo == NULL) {
+        return 0;
+    }
+
+    huellaVentas(huella);
+    fprintf(archivo, "%s\n", huella);
+    for (int i = 0; i < indice->cantidad; i++) {
+        fprintf(archivo, "%d\n", indice->numeros[i]);
+    }
+
+    error = ferror(archivo);
+    if (fclose(archivo) != 0 || error) {
+        remove("facturas.idx");  // Sin ndice vlido la prxima carga lo reconstruye
+        return 0;
+    }
+    return 1;
+}
+
+// Al terminar la carga deja facturas.idx ordenado y libera la memoria del ndice.
+// Si falt memoria no se reescribe: el archivo ya tiene todas las facturas agregadas una por una
+void guardarIndiceFacturas(IndiceFacturas *indice) {
+    if (!indice->incompleto) {
+        escribirIndiceFacturas(indice);
+    }
+
+    free(indice->numeros);
+    indice->numeros = NULL;
+    indice->cantidad = 0;
+    indice->capacidad = 0;
 }
 
 int buscarProducto(int idProducto, Producto *productoInfo) {
@@ -356,12 +729,187 @@ int buscarCiudad(int codigoCiudad, Ciudad *ciudadInfo) {
     return 0;
 }
 
+// Parsea una linea de ventas.txt con formato Factura|Fecha|Producto|Ciudad|Cantidad|Precio
+// Las ventas anteriores al precio guardado no tienen el ultimo campo: se usa el precio actual
+int parsearVenta(char *linea, Venta *ventaInfo) {
+    Producto productoInfo;
+
+    char *token = strtok(linea, "|");
+    if (token == NULL) return 0;
+    ventaInfo->numeroFactura = atoi(token);
+
+    token = strtok(NULL, "|");
+    if (token == NULL) return 0;
+    strcpy(ventaInfo->fechaVenta, token);
+
+    token = strtok(NULL, "|");
+    if (token == NULL) return 0;
+    ventaInfo->idProducto = atoi(token);
+
+    token = strtok(NULL, "|");
+    if (token == NULL) return 0;
+    ventaInfo->codigoCiudad = atoi(token);
+
+    token = strtok(NULL, "|\n");
+    if (token == NULL) return 0;
+    ventaInfo->cantidadVendida = atof(token);
+
+    token = strtok(NULL, "|\n");
+    if (token != NULL) {
+        ventaInfo->precioUnitario = atof(token);
+    } else if (buscarProducto(ventaInfo->idProducto, &productoInfo)) {
+        ventaInfo->precioUnitario = productoInfo.precioProducto;
+    } else {
+        ventaInfo->precioUnitario = 0;
+    }
+
+    return 1;
+}
+
+// Reescribe ventas.txt agregando el precio actual del producto a las ventas que no lo tienen
+// Las lineas que no se pueden completar (producto inexistente o mal formadas) quedan igual
+void migrarVentas() {
+    FILE *archivo, *temporal;
+    char linea[200], copia[200];
+    Venta ventaInfo;
+    Producto productoInfo;
+    int migradas = 0;
+    int hayAntiguas = 0;
+
+    archivo = fopen("ventas.txt", "r");
+    if (archivo == NULL) {
+        return;
+    }
+
+    // Antes de copiar nada se busca alguna venta antigua (5 campos) que se pueda completar.
+    // Las ventas nuevas siempre se agregan al final con 6 campos, as que al encontrar la
+    // primera de 6 campos ya no puede haber antiguas despus y se deja de leer
+    while (!hayAntiguas && fgets(linea, sizeof(linea), archivo)) {
+        int campos = contarCampos(linea);
+        if (campos == 6) break;
+
+        strcpy(copia, linea);
+        hayAntiguas = campos == 5 && parsearVenta(copia, &ventaInfo) &&
+                      buscarProducto(ventaInfo.idProducto, &productoInfo);
+    }
+
+    if (!hayAntiguas) {
+        fclose(archivo);
+        return;
+    }
+
+    rewind(archivo);
+
+    temporal = fopen("ventas.tmp", "w");
+    if (temporal == NULL) {
+        fclose(archivo);
+        return;
+    }
+
+    while (fgets(linea, sizeof(linea), archivo)) {
+        strcpy(copia, linea);  // strtok modifica la linea, se parsea una copia
+        if (contarCampos(linea) == 5 && parsearVenta(copia, &ventaInfo) &&
+            buscarProducto(ventaInfo.idProducto, &productoInfo)) {
+            fprintf(temporal, "%d|%s|%d|%d|%.2f|%.2f\n", ventaInfo.numeroFactura,
+                    ventaInfo.fechaVenta, ventaInfo.idProducto,
+                    ventaInfo.codigoCiudad, ventaInfo.cantidadVendida,
+                    productoInfo.precioProducto);
+            migradas++;
+        } else {
+            fputs(linea, temporal);
+        }
+    }
+
+    int errorEscritura = ferror(temporal);
+    fclose(archivo);
+
+    // Si ventas.tmp no qued completo no se toca ventas.txt
+    if (fclose(temporal) != 0 || errorEscritura) {
+        printf("Error al escribir ventas.tmp, no se migraron las ventas.\n");
+        remove("ventas.tmp");
+        return;
+    }
+
+    // Solo se reemplaza el archivo si hubo cambios
+    if (migradas == 0) {
+        remove("ventas.tmp");
+        return;
+    }
+
+    // El original se aparta como ventas.bak y se borra solo cuando ventas.tmp ya ocup su lugar
+    remove("ventas.bak");
+    if (rename("ventas.txt", "ventas.bak") != 0) {
+        printf("No se pudo migrar ventas.txt; las ventas migradas quedaron en ventas.tmp\n");
+        return;
+    }
+
+    if (rename("ventas.tmp", "ventas.txt") != 0) {
+        rename("ventas.bak", "ventas.txt");
+        printf("No se pudo migrar ventas.txt; las ventas migradas quedaron en ventas.tmp\n");
+        return;
+    }
+
+    remove("ventas.bak");
+}
+
+// Cuenta los campos de una lnea de ventas.txt (las ventas antiguas tienen 5, las nuevas 6)
+int contarCampos(const char *linea) {
+    int campos = 1;
+    for (const char *c = linea; *c != '\0'; c++) {
+        if (*c == '|') campos++;
+    }
+    return campos;
+}
+
+// Busca un producto primero entre los ya ledos, as productos.txt se consulta una sola vez por producto
+// Si el producto no existe se devuelve con nombre "(desconocido)"
+void obtenerProducto(int idProducto, Producto vistos[], int *numVistos, Producto *productoInfo) {
+    for (int i = 0; i < *numVistos; i++) {
+        if (vistos[i].idProducto == idProducto) {
+            *productoInfo = vistos[i];
+            return;
+        }
+    }
+
+    if (!buscarProducto(idProducto, productoInfo)) {
+        productoInfo->idProducto = idProducto;
+        strcpy(productoInfo->nombreProducto, "(desconocido)");
+        productoInfo->precioProducto = 0;
+    }
+
+    if (*numVistos < 100) {
+        vistos[(*numVistos)++] = *productoInfo;
+    }
+}
+
+// Igual que obtenerProducto, pero para ciudades.txt
+void obtenerCiudad(int codigoCiudad, Ciudad vistas[], int *numVistas, Ciudad *ciudadInfo) {
+    for (int i = 0; i < *numVistas; i++) {
+        if (vistas[i].codigoCiudad == codigoCiudad) {
+            *ciudadInfo = vistas[i];
+            return;
+        }
+    }
+
+    if (!buscarCiudad(codigoCiudad, ciudadInfo)) {
+        ciudadInfo->codigoCiudad = codigoCiudad;
+        strcpy(ciudadInfo->nombreCiudad, "(desconocido)");
+    }
+
+    if (*numVistas < 100) {
+        vistas[(*numVistas)++] = *ciudadInfo;
+    }
+}
+
 void listadoPorCiudadYProducto() {
     FILE *archivo;
     char linea[200];
     Venta ventaInfo;
     Producto productoInfo;
     Ciudad ciudadInfo;
+    Producto productosVistos[100];  // Nombres ya ledos, para no releer los archivos
+    Ciudad ciudadesVistas[100];
+    int numProductosVistos = 0, numCiudadesVistas = 0;
     int ciudadActual = -1;
     float totalCiudad = 0;
     float totalGeneral = 0;
@@ -376,25 +924,7 @@ void listadoPorCiudadYProducto() {
 
     while (fgets(linea, sizeof(linea), archivo)) {
         // Parsear la lnea de venta
-        char *token = strtok(linea, "|");
-        if (token == NULL) continue;
-        ventaInfo.numeroFactura = atoi(token);
-
-        token = strtok(NULL, "|");
-        if (token == NULL) continue;
-        strcpy(ventaInfo.fechaVenta, token);
-
-        token = strtok(NULL, "|");
-        if (token == NULL) continue;
-        ventaInfo.idProducto = atoi(token);
-
-        token = strtok(NULL, "|");
-        if (token == NULL) continue;
-        ventaInfo.codigoCiudad = atoi(token);
-
-        token = strtok(NULL, "|\n");
-        if (token == NULL) continue;
-        ventaInfo.cantidadVendida = atof(token);
+        if (!parsearVenta(linea, &ventaInfo)) continue;
 
         if (ventaInfo.codigoCiudad != ciudadActual) {
             if (ciudadActual != -1) {
@@ -404,19 +934,18 @@ void listadoPorCiudadYProducto() {
             ciudadActual = ventaInfo.codigoCiudad;
             totalCiudad = 0;
 
-            if (buscarCiudad(ventaInfo.codigoCiudad, &ciudadInfo)) {
-                printf("Ciudad %d- %s:\n", ventaInfo.codigoCiudad, ciudadInfo.nombreCiudad);
-            }
+            obtenerCiudad(ventaInfo.codigoCiudad, ciudadesVistas, &numCiudadesVistas, &ciudadInfo);
+            printf("Ciudad %d- %s:\n", ventaInfo.codigoCiudad, ciudadInfo.nombreCiudad);
         }
 
-        if (buscarProducto(ventaInfo.idProducto, &productoInfo)) {
-            float total = ventaInfo.cantidadVendida * productoInfo.precioProducto;
-            printf("Producto %d- %s Cant. %.0f precio %.2f Total $ %.2f\n",
-                   ventaInfo.idProducto, productoInfo.nombreProducto,
-                   ventaInfo.cantidadVendida, productoInfo.precioProducto, total);
-            totalCiudad += total;
-            totalGeneral += total;
-        }
+        // El total sale de la propia venta; el catlogo solo aporta el nombre
+        obtenerProducto(ventaInfo.idProducto, productosVistos, &numProductosVistos, &productoInfo);
+        float total = ventaInfo.cantidadVendida * ventaInfo.precioUnitario;
+        printf("Producto %d- %s Cant. %.0f precio %.2f Total $ %.2f\n",
+               ventaInfo.idProducto, productoInfo.nombreProducto,
+               ventaInfo.cantidadVendida, ventaInfo.precioUnitario, total);
+        totalCiudad += total;
+        totalGeneral += total;
     }
 
     if (ciudadActual != -1) {
@@ -434,6 +963,9 @@ void listadoPorProductoYCiudad() {
     Venta ventaInfo;
     Producto productoInfo;
     Ciudad ciudadInfo;
+    Producto productosVistos[100];  // Nombres ya ledos, para no releer los archivos
+    Ciudad ciudadesVistas[100];
+    int numProductosVistos = 0, numCiudadesVistas = 0;
     int productoActual = -1;
     float totalProducto = 0;
     float totalGeneral = 0;
@@ -448,25 +980,7 @@ void listadoPorProductoYCiudad() {
 
     while (fgets(linea, sizeof(linea), archivo)) {
         // Parsear la lnea de venta
-        char *token = strtok(linea, "|");
-        if (token == NULL) continue;
-        ventaInfo.numeroFactura = atoi(token);
-
-        token = strtok(NULL, "|");
-        if (token == NULL) continue;
-        strcpy(ventaInfo.fechaVenta, token);
-
-        token = strtok(NULL, "|");
-        if (token == NULL) continue;
-        ventaInfo.idProducto = atoi(token);
-
-        token = strtok(NULL, "|");
-        if (token == NULL) continue;
-        ventaInfo.codigoCiudad = atoi(token);
-
-        token = strtok(NULL, "|\n");
-        if (token == NULL) continue;
-        ventaInfo.cantidadVendida = atof(token);
+        if (!parsearVenta(linea, &ventaInfo)) continue;
 
         if (ventaInfo.idProducto != productoActual) {
             if (productoActual != -1) {
@@ -476,19 +990,18 @@ void listadoPorProductoYCiudad() {
             productoActual = ventaInfo.idProducto;
             totalProducto = 0;
 
-            if (buscarProducto(ventaInfo.idProducto, &productoInfo)) {
-                printf("Producto %d- %s:\n", ventaInfo.idProducto, productoInfo.nombreProducto);
-            }
+            obtenerProducto(ventaInfo.idProducto, productosVistos, &numProductosVistos, &productoInfo);
+            printf("Producto %d- %s:\n", ventaInfo.idProducto, productoInfo.nombreProducto);
         }
 
-        if (buscarCiudad(ventaInfo.codigoCiudad, &ciudadInfo)) {
-            float total = ventaInfo.cantidadVendida * productoInfo.precioProducto;
-            printf("Ciudad %d- %s Cant. %.0f precio %.2f Total $ %.2f\n",
-                   ventaInfo.codigoCiudad, ciudadInfo.nombreCiudad,
-                   ventaInfo.cantidadVendida, productoInfo.precioProducto, total);
-            totalProducto += total;
-            totalGeneral += total;
-        }
+        // El total sale de la propia venta; el catlogo solo aporta el nombre
+        obtenerCiudad(ventaInfo.codigoCiudad, ciudadesVistas, &numCiudadesVistas, &ciudadInfo);
+        float total = ventaInfo.cantidadVendida * ventaInfo.precioUnitario;
+        printf("Ciudad %d- %s Cant. %.0f precio %.2f Total $ %.2f\n",
+               ventaInfo.codigoCiudad, ciudadInfo.nombreCiudad,
+               ventaInfo.cantidadVendida, ventaInfo.precioUnitario, total);
+        totalProducto += total;
+        totalGeneral += total;
     }
 
     if (productoActual != -1) {
@@ -524,6 +1037,9 @@ void mostrarEstadisticas() {
     EstadisticaCiudad estadCiudades[100];
     EstadisticaProducto estadProductos[100];
     int numCiudades = 0, numProductos = 0;
+    Producto productosVistos[100];  // Nombres ya ledos, para no releer los archivos
+    Ciudad ciudadesVistas[100];
+    int numProductosVistos = 0, numCiudadesVistas = 0;
 
     // Inicializar arrays
     for(int i = 0; i < 100; i++) {
@@ -544,67 +1060,51 @@ void mostrarEstadisticas() {
     // Procesar ventas y acumular estadsticas
     while (fgets(linea, sizeof(linea), archivo)) {
         // Parsear la lnea de venta
-        char *token = strtok(linea, "|");
-        if (token == NULL) continue;
-        ventaInfo.numeroFactura = atoi(token);
-
-        token = strtok(NULL, "|");
-        if (token == NULL) continue;
-        strcpy(ventaInfo.fechaVenta, token);
-
-        token = strtok(NULL, "|");
-        if (token == NULL) continue;
-        ventaInfo.idProducto = atoi(token);
-
-        token = strtok(NULL, "|");
-        if (token == NULL) continue;
-        ventaInfo.codigoCiudad = atoi(token);
-
-        token = strtok(NULL, "|\n");
-        if (token == NULL) continue;
-        ventaInfo.cantidadVendida = atof(token);
+        if (!parsearVenta(linea, &ventaInfo)) continue;
 
-        if (buscarProducto(ventaInfo.idProducto, &productoInfo) &&
-            buscarCiudad(ventaInfo.codigoCiudad, &ciudadInfo)) {
+        // El total sale de la propia venta, sin consultar productos.txt
+        float totalVenta = ventaInfo.cantidadVendida * ventaInfo.precioUnitario;
 
-            float totalVenta = ventaInfo.cantidadVendida * productoInfo.precioProducto;
-
-            // Buscar o crear estadstica de ciudad
-            int indiceCiudad = -1;
-            for(int i = 0; i < numCiudades; i++) {
-                if(estadCiudades[i].codigo == ventaInfo.codigoCiudad) {
-                    indiceCiudad = i;
-                    break;
-                }
+        // Buscar estadstica de ciudad
+        int indiceCiudad = -1;
+        for(int i = 0; i < numCiudades; i++) {
+            if(estadCiudades[i].codigo == ventaInfo.codigoCiudad) {
+                indiceCiudad = i;
+                break;
             }
+        }
 
-            if(indiceCiudad == -1) {
-                indiceCiudad = numCiudades++;
-                estadCiudades[indiceCiudad].codigo = ventaInfo.codigoCiudad;
-                strcpy(estadCiudades[indiceCiudad].nombre, ciudadInfo.nombreCiudad);
+        // Buscar estadstica de producto
+        int indiceProducto = -1;
+        for(int i = 0; i < numProductos; i++) {
+            if(estadProductos[i].id == ventaInfo.idProducto) {
+                indiceProducto = i;
+                break;
             }
+        }
 
-            estadCiudades[indiceCiudad].totalVendido += totalVenta;
-            estadCiudades[indiceCiudad].cantidadVentas++;
-
-            // Buscar o crear estadstica de producto
-            int indiceProducto = -1;
-            for(int i = 0; i < numProductos; i++) {
-                if(estadProductos[i].id == ventaInfo.idProducto) {
-                    indiceProducto = i;
-                    break;
-                }
-            }
+        // Los nombres solo se buscan la primera vez que aparece cada ciudad o producto.
+        // Igual que en los listados, una venta sin producto o ciudad en el catlogo
+        // se cuenta como "(desconocido)" para que los totales coincidan
+        if(indiceCiudad == -1) {
+            obtenerCiudad(ventaInfo.codigoCiudad, ciudadesVistas, &numCiudadesVistas, &ciudadInfo);
+            indiceCiudad = numCiudades++;
+            estadCiudades[indiceCiudad].codigo = ventaInfo.codigoCiudad;
+            strcpy(estadCiudades[indiceCiudad].nombre, ciudadInfo.nombreCiudad);
+        }
 
-            if(indiceProducto == -1) {
-                indiceProducto = numProductos++;
-                estadProductos[indiceProducto].id = ventaInfo.idProducto;
-                strcpy(estadProductos[indiceProducto].nombre, productoInfo.nombreProducto);
-            }
+        estadCiudades[indiceCiudad].totalVendido += totalVenta;
+        estadCiudades[indiceCiudad].cantidadVentas++;
 
-            estadProductos[indiceProducto].totalVendido += totalVenta;
-            estadProductos[indiceProducto].cantidadVentas++;
+        if(indiceProducto == -1) {
+            obtenerProducto(ventaInfo.idProducto, productosVistos, &numProductosVistos, &productoInfo);
+            indiceProducto = numProductos++;
+            estadProductos[indiceProducto].id = ventaInfo.idProducto;
+            strcpy(estadProductos[indiceProducto].nombre, productoInfo.nombreProducto);
         }
+
+        estadProductos[indiceProducto].totalVendido += totalVenta;
+        estadProductos[indiceProducto].cantidadVentas++;
     }
 
     fclose(archivo);